@@ -64,6 +64,18 @@ extern "C"
 #undef HAVE_SECURE_GETENV
 #endif
 
+/*
+ * Use the event-driven curl-multi network backend instead of the blocking
+ * curl-easy backend. The curl-multi backend drives all HTTP requests from one
+ * I/O thread using epoll which implies that the number of concurrent HTTP
+ * requests is not limited by the number of threads. Callers waiting for the
+ * result of a request still block, but the asynchronous API acvp_http_async
+ * is offered in addition.
+ * NOTE The curl-multi backend requires ACVP_USE_PTHREAD to be set and is only
+ *	available on Linux.
+ */
+#define ACVP_CURL_MULTI
+
 /************************************************************************
  * Sanity check
  ************************************************************************/
@@ -73,6 +85,15 @@ extern "C"
 # endif
 #endif
 
+#ifdef ACVP_CURL_MULTI
+# ifndef ACVP_USE_PTHREAD
+#  error "CURL multi network backend requires PTHREAD support"
+# endif
+# ifndef __linux__
+#  error "CURL multi network backend requires Linux epoll support"
+# endif
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -91,11 +91,19 @@ struct acvp_na_ex {
 	const struct acvp_auth_ctx *server_auth;
 };
 
+/* HTTP request types */
+enum acvp_http_type {
+	ACVP_HTTP_GET,
+	ACVP_HTTP_POST,
+	ACVP_HTTP_PUT,
+	ACVP_HTTP_DELETE,
+};
+
 /**
  * Network access backend
  *
  * This backend defines callback functions to be implemented by the network
- * access backends. All callbacks must be implemented
+ * access backends. All callbacks except acvp_http_async must be implemented
  *
  * @acvp_http_post: The data provided in register_buf shall be sent to the
  *		    CAVP server. This callback implements the HTTP POST. The
@@ -115,6 +123,14 @@ struct acvp_na_ex {
  * @acvp_http_delete: Perform a HTTP DELETE operation on the given URL.
  * @acvp_http_interrupt: Signal handler interrupted network operation, shut down
  *			 network operation gracefully.
+ * @acvp_http_async: Optional asynchronous HTTP request (NULL if the backend
+ *		     does not support it). The function returns after queuing
+ *		     the request. Once the request completed, the callback
+ *		     complete() is invoked from the I/O thread of the backend
+ *		     with the return code of the request (0 on success, < 0 on
+ *		     error). The caller must keep netinfo and both buffers
+ *		     alive until the callback is invoked. The callback must
+ *		     not block.
  */
 struct acvp_netaccess_be {
 	int (*acvp_http_post)(const struct acvp_na_ex *netinfo,
@@ -127,6 +143,12 @@ struct acvp_netaccess_be {
 			     struct acvp_buf *response_buf);
 	int (*acvp_http_delete)(const struct acvp_na_ex *netinfo);
 	void (*acvp_http_interrupt)(void);
+	int (*acvp_http_async)(const struct acvp_na_ex *netinfo,
+			       enum acvp_http_type http_type,
+			       const struct acvp_buf *submit_buf,
+			       struct acvp_buf *response_buf,
+			       void (*complete)(void *priv, int ret),
+			       void *priv);
 };
 
 /**
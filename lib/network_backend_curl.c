@@ -18,6 +18,7 @@
  * DAMAGE.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,19 +26,27 @@
 
 #include <curl/curl.h>
 
+#include "atomic.h"
 #include "atomic_bool.h"
 #include "logger.h"
 #include "acvpproxy.h"
 #include "internal.h"
+#include "network_backend_curl.h"
 #include "sleep.h"
 
 #define HTTP_OK			200
-#define ACVP_CURL_MAX_RETRIES	3
+
+/*
+ * Maximum number of idle CURL easy handles kept in the handle pool. At most
+ * one handle is in use per thread, so this value need not be larger than the
+ * number of threads that can be active concurrently.
+ */
+#define ACVP_CURL_MAX_IDLE_HANDLES	(THREADING_MAX_THREADS + 2)
 
 /*
  * Shall the ACVP operation be shut down?
  */
-static atomic_bool_t acvp_curl_interrupted = ATOMIC_BOOL_INIT(false);
+atomic_bool_t acvp_curl_interrupted = ATOMIC_BOOL_INIT(false);
 
 static void acvp_curl_interrupt(void)
 {
@@ -49,6 +58,182 @@ static void acvp_curl_clear_interrupt(void)
 	atomic_bool_set_false(&acvp_curl_interrupted);
 }
 
+/*****************************************************************************
+ * CURL handle pool with shared DNS / TLS session / connection cache
+ *****************************************************************************/
+
+/*
+ * All CURL easy handles share one CURLSH instance holding the DNS cache, the
+ * TLS session cache and the connection cache. This implies that a keep-alive
+ * connection to the ACVP server (including the TLS session and the parsed
+ * client certificate / key) survives the individual HTTP requests and can be
+ * reused by any thread.
+ */
+static CURLSH *acvp_curl_share = NULL;
+static pthread_mutex_t acvp_curl_share_lock[CURL_LOCK_DATA_LAST];
+
+/*
+ * Idle CURL easy handles ready for reuse. A handle is removed from the pool
+ * while it is used by one HTTP request and returned afterwards.
+ */
+static CURL *acvp_curl_idle[ACVP_CURL_MAX_IDLE_HANDLES];
+static unsigned int acvp_curl_idle_num = 0;
+static pthread_mutex_t acvp_curl_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Statistics: new connections (incl. TLS handshake) vs. reused connections */
+static atomic_t acvp_curl_conn_new = ATOMIC_INIT(0);
+static atomic_t acvp_curl_conn_reused = ATOMIC_INIT(0);
+
+static void acvp_curl_share_lock_cb(CURL *handle, curl_lock_data data,
+				    curl_lock_access access, void *userptr)
+{
+	(void)handle;
+	(void)access;
+	(void)userptr;
+
+	if (data < CURL_LOCK_DATA_LAST)
+		pthread_mutex_lock(&acvp_curl_share_lock[data]);
+}
+
+static void acvp_curl_share_unlock_cb(CURL *handle, curl_lock_data data,
+				      void *userptr)
+{
+	(void)handle;
+	(void)userptr;
+
+	if (data < CURL_LOCK_DATA_LAST)
+		pthread_mutex_unlock(&acvp_curl_share_lock[data]);
+}
+
+static void acvp_curl_share_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_init(&acvp_curl_share_lock[i], NULL);
+
+	acvp_curl_share = curl_share_init();
+	if (!acvp_curl_share) {
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Cannot allocate CURL share handle - connections are not reused\n");
+		return;
+	}
+
+	if (curl_share_setopt(acvp_curl_share, CURLSHOPT_LOCKFUNC,
+			      acvp_curl_share_lock_cb) ||
+	    curl_share_setopt(acvp_curl_share, CURLSHOPT_UNLOCKFUNC,
+			      acvp_curl_share_unlock_cb) ||
+	    curl_share_setopt(acvp_curl_share, CURLSHOPT_SHARE,
+			      CURL_LOCK_DATA_DNS) ||
+	    curl_share_setopt(acvp_curl_share, CURLSHOPT_SHARE,
+			      CURL_LOCK_DATA_SSL_SESSION) ||
+	    curl_share_setopt(acvp_curl_share, CURLSHOPT_SHARE,
+			      CURL_LOCK_DATA_CONNECT)) {
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Cannot configure CURL share handle - connections are not reused\n");
+		curl_share_cleanup(acvp_curl_share);
+		acvp_curl_share = NULL;
+	}
+}
+
+static void acvp_curl_share_release(void)
+{
+	unsigned int i;
+
+	if (acvp_curl_share) {
+		curl_share_cleanup(acvp_curl_share);
+		acvp_curl_share = NULL;
+	}
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_destroy(&acvp_curl_share_lock[i]);
+}
+
+/*
+ * Obtain a CURL easy handle - either an idle one from the pool or a
+ * newly allocated one.
+ */
+CURL *acvp_curl_handle_get(void)
+{
+	CURL *curl = NULL;
+
+	pthread_mutex_lock(&acvp_curl_idle_lock);
+	if (acvp_curl_idle_num)
+		curl = acvp_curl_idle[--acvp_curl_idle_num];
+	pthread_mutex_unlock(&acvp_curl_idle_lock);
+
+	if (curl)
+		return curl;
+
+	curl = curl_easy_init();
+	if (!curl)
+		return NULL;
+
+	if (acvp_curl_share &&
+	    curl_easy_setopt(curl, CURLOPT_SHARE, acvp_curl_share)) {
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Cannot attach CURL share handle\n");
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_CURL, "New CURL handle allocated\n");
+
+	return curl;
+}
+
+/*
+ * Return the CURL easy handle to the pool. All options are reset, but the
+ * handle keeps its shared caches and live connections.
+ */
+void acvp_curl_handle_put(CURL *curl)
+{
+	if (!curl)
+		return;
+
+	curl_easy_reset(curl);
+
+	pthread_mutex_lock(&acvp_curl_idle_lock);
+	if (acvp_curl_idle_num < ACVP_CURL_MAX_IDLE_HANDLES) {
+		acvp_curl_idle[acvp_curl_idle_num++] = curl;
+		curl = NULL;
+	}
+	pthread_mutex_unlock(&acvp_curl_idle_lock);
+
+	if (curl)
+		curl_easy_cleanup(curl);
+}
+
+static void acvp_curl_handle_release_all(void)
+{
+	pthread_mutex_lock(&acvp_curl_idle_lock);
+	while (acvp_curl_idle_num)
+		curl_easy_cleanup(acvp_curl_idle[--acvp_curl_idle_num]);
+	pthread_mutex_unlock(&acvp_curl_idle_lock);
+}
+
+/* Account whether the last transfer required a new connection. */
+static void acvp_curl_conn_stats(CURL *curl)
+{
+	long new_conns = 0;
+
+	if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_conns))
+		return;
+
+	if (new_conns > 0)
+		atomic_add((int)new_conns, &acvp_curl_conn_new);
+	else
+		atomic_inc(&acvp_curl_conn_reused);
+
+	logger(LOGGER_VERBOSE, LOGGER_C_CURL,
+	       "Connection %s (total: %d new connections with TLS handshake, %d reused connections)\n",
+	       new_conns > 0 ? "established" : "reused",
+	       atomic_read(&acvp_curl_conn_new),
+	       atomic_read(&acvp_curl_conn_reused));
+}
+
+/*****************************************************************************
+ * HTTP operations
+ *****************************************************************************/
+
 static int acvp_curl_progress_callback(void *clientp, curl_off_t dltotal,
 				       curl_off_t dlnow, curl_off_t ultotal,
 				       curl_off_t ulnow)
@@ -168,27 +353,20 @@ static void acvp_curl_log_peer_cert(CURL *hnd)
 	}
 }
 
-enum acvp_http_type {
-	ACVP_HTTP_GET,
-	ACVP_HTTP_POST,
-	ACVP_HTTP_PUT,
-	ACVP_HTTP_DELETE,
-};
-
-static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
-				 const struct acvp_buf *submit_buf,
-				 struct acvp_buf *response_buf,
-				 enum acvp_http_type http_type)
+int acvp_curl_http_setup(CURL *curl, const struct acvp_na_ex *netinfo,
+			 const struct acvp_buf *submit_buf,
+			 struct acvp_buf *response_buf,
+			 enum acvp_http_type http_type,
+			 struct curl_slist **slist_out)
 {
 	const struct acvp_net_ctx *net = netinfo->net;
 	const struct acvp_auth_ctx *auth = netinfo->server_auth;
 	struct curl_slist *slist = NULL;
-	CURL *curl = NULL;
-	CURLcode cret;
 	const char *url = netinfo->url;
 	char useragent[30];
 	int ret;
-	unsigned int retries = 0;
+
+	*slist_out = NULL;
 
 	CKNULL_LOG(net, -EINVAL, "Network context missing\n");
 	CKNULL_LOG(url, -EINVAL, "URL missing\n");
@@ -201,11 +379,11 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 
 	slist = acvp_curl_add_auth_hdr(auth, slist);
 	CKNULL(slist, -ENOMEM);
+	*slist_out = slist;
 
-	curl = curl_easy_init();
-	CKNULL(curl, -ENOMEM);
 	CKINT(curl_easy_setopt(curl, CURLOPT_URL, url));
 	CKINT(curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L));
+	/* libcurl copies the user agent string */
 	CKINT(curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent));
 	CKINT(curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist));
 	CKINT(curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
@@ -293,6 +471,44 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 	CKINT(curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_buf));
 	CKINT(curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, acvp_curl_cb));
 
+out:
+	return ret;
+}
+
+int acvp_curl_http_status(CURL *curl, const char *url)
+{
+	long http_code = 0;
+
+	acvp_curl_log_peer_cert(curl);
+	acvp_curl_conn_stats(curl);
+
+	/* Get the HTTP response status code from the server */
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+	if (http_code == HTTP_OK)
+		return 0;
+
+	logger(LOGGER_WARN, LOGGER_C_CURL,
+	       "Unable to HTTP GET data for URL %s: %ld\n", url, http_code);
+	return -ECONNREFUSED;
+}
+
+static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
+				 const struct acvp_buf *submit_buf,
+				 struct acvp_buf *response_buf,
+				 enum acvp_http_type http_type)
+{
+	struct curl_slist *slist = NULL;
+	CURL *curl = NULL;
+	CURLcode cret;
+	int ret;
+	unsigned int retries = 0;
+
+	curl = acvp_curl_handle_get();
+	CKNULL(curl, -ENOMEM);
+
+	CKINT(acvp_curl_http_setup(curl, netinfo, submit_buf, response_buf,
+				   http_type, &slist));
+
 	/*
 	 * Clear any interrupt triggered by signal handler to allow
 	 * signal handler to perform network requests.
@@ -311,25 +527,14 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 
 		retries++;
 		if (retries < ACVP_CURL_MAX_RETRIES)
-			CKINT(sleep_interruptible(10, &acvp_curl_interrupted));
+			CKINT(sleep_interruptible(ACVP_CURL_RETRY_WAIT,
+						  &acvp_curl_interrupted));
 	}
 
-	acvp_curl_log_peer_cert(curl);
-
-	/* Get the HTTP response status code from the server */
-	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &ret);
-	if (ret == HTTP_OK) {
-		ret = 0;
-	} else {
-		logger(LOGGER_WARN, LOGGER_C_CURL,
-		       "Unable to HTTP GET data for URL %s: %d\n", url,
-		       ret);
-		ret = -ECONNREFUSED;
-	}
+	ret = acvp_curl_http_status(curl, netinfo->url);
 
 out:
-	if (curl)
-		curl_easy_cleanup(curl);
+	acvp_curl_handle_put(curl);
 	if (slist)
 		curl_slist_free_all(slist);
 	return ret;
@@ -368,11 +573,27 @@ static struct acvp_netaccess_be acvp_netaccess_curl = {
 	&acvp_curl_http_get,
 	&acvp_curl_http_put,
 	&acvp_curl_http_delete,
-	&acvp_curl_interrupt
+	&acvp_curl_interrupt,
+	NULL
 };
 
 ACVP_DEFINE_CONSTRUCTOR(acvp_curl_init)
 static void acvp_curl_init(void)
 {
+	curl_global_init(CURL_GLOBAL_ALL);
+	acvp_curl_share_init();
+#ifdef ACVP_CURL_MULTI
+	/* The curl-multi backend registers itself */
+	(void)acvp_netaccess_curl;
+#else
 	acvp_register_na(&acvp_netaccess_curl);
+#endif
+}
+
+ACVP_DEFINE_DESTRUCTOR(acvp_curl_fini)
+static void acvp_curl_fini(void)
+{
+	acvp_curl_handle_release_all();
+	acvp_curl_share_release();
+	curl_global_cleanup();
 }
@@ -0,0 +1,93 @@
+/* Network access backend using libcurl - common helper
+ *
+ * Copyright (C) 2018, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef NETWORK_BACKEND_CURL_H
+#define NETWORK_BACKEND_CURL_H
+
+#include <curl/curl.h>
+
+#include "atomic_bool.h"
+#include "internal.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ACVP_CURL_MAX_RETRIES	3
+/* Time in seconds to wait before retrying a failed CURL operation */
+#define ACVP_CURL_RETRY_WAIT	10
+
+/*
+ * Shall the ACVP network operation be shut down? This flag is checked by the
+ * CURL progress callback of all network backends.
+ */
+extern atomic_bool_t acvp_curl_interrupted;
+
+/**
+ * @brief Obtain a CURL easy handle from the handle pool. The handle shares
+ *	  the DNS, TLS session and connection cache with all other handles.
+ *
+ * @return CURL handle or NULL on error
+ */
+CURL *acvp_curl_handle_get(void);
+
+/**
+ * @brief Return CURL easy handle to the pool. All options set for the handle
+ *	  are reset.
+ */
+void acvp_curl_handle_put(CURL *curl);
+
+/**
+ * @brief Set all CURL options for the HTTP request described by the
+ *	  parameters. The caller must free the returned header list with
+ *	  curl_slist_free_all() after the request completed.
+ *
+ * @param curl [in] CURL handle to configure
+ * @param netinfo [in] Network information
+ * @param submit_buf [in] Data to send to the server (may be NULL)
+ * @param response_buf [in] Buffer receiving the server response (may be NULL)
+ * @param http_type [in] HTTP request type
+ * @param slist [out] HTTP header list allocated for the request
+ *
+ * @return 0 on success, < 0 on error
+ */
+int acvp_curl_http_setup(CURL *curl, const struct acvp_na_ex *netinfo,
+			 const struct acvp_buf *submit_buf,
+			 struct acvp_buf *response_buf,
+			 enum acvp_http_type http_type,
+			 struct curl_slist **slist);
+
+/**
+ * @brief Evaluate the outcome of a completed HTTP request (HTTP status code,
+ *	  peer certificate logging, connection statistics).
+ *
+ * @param curl [in] CURL handle of completed transfer
+ * @param url [in] URL used for the request (for logging)
+ *
+ * @return 0 on HTTP success, < 0 on error
+ */
+int acvp_curl_http_status(CURL *curl, const char *url);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETWORK_BACKEND_CURL_H */
@@ -0,0 +1,715 @@
+/* Event-driven network access backend using libcurl multi interface
+ *
+ * Copyright (C) 2018, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * The curl-multi backend executes all HTTP requests from one I/O thread.
+ * The I/O thread waits with epoll for socket events of all transfers, for
+ * the timer requested by libcurl and for an eventfd that is used to signal
+ * newly submitted requests and interrupts. Thus, the number of concurrent
+ * HTTP requests is not bound to the number of threads.
+ *
+ * Requests are submitted with acvp_curl_multi_async and the caller-provided
+ * completion callback is invoked by the I/O thread. The synchronous
+ * acvp_netaccess_be callbacks are implemented on top of the asynchronous
+ * API.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "atomic.h"
+#include "atomic_bool.h"
+#include "logger.h"
+#include "acvpproxy.h"
+#include "internal.h"
+#include "network_backend_curl.h"
+
+/* Maximum number of epoll events processed in one loop iteration */
+#define ACVP_CURL_MULTI_EVENTS	64
+
+struct acvp_curl_multi_req {
+	struct acvp_curl_multi_req *next;
+	CURL *curl;
+	struct curl_slist *slist;
+	const char *url;
+	unsigned int retries;
+	int interrupt_gen;	/* Interrupt generation at submission time */
+	uint64_t retry_at;	/* Monotonic time in ms for retry */
+	void (*complete)(void *priv, int ret);
+	void *priv;
+};
+
+struct acvp_curl_multi_ctx {
+	CURLM *multi;
+	int epfd;
+	int evfd;
+	pthread_t thread;
+	bool started;
+	atomic_bool_t shutdown;
+
+	/* Monotonic time in ms when libcurl wants to be called, 0 for none */
+	uint64_t timer_at;
+
+	/* Newly submitted requests - protected by submit_lock */
+	struct acvp_curl_multi_req *submitted;
+	pthread_mutex_t submit_lock;
+
+	/* Requests waiting for a retry - only accessed by I/O thread */
+	struct acvp_curl_multi_req *deferred;
+
+	/* Requests handed to libcurl - only accessed by I/O thread */
+	struct acvp_curl_multi_req *active;
+	unsigned int active_num;
+};
+
+static struct acvp_curl_multi_ctx acvp_curl_multi = {
+	.multi = NULL,
+	.epfd = -1,
+	.evfd = -1,
+	.started = false,
+	.shutdown = ATOMIC_BOOL_INIT(false),
+	.timer_at = 0,
+	.submitted = NULL,
+	.submit_lock = PTHREAD_MUTEX_INITIALIZER,
+	.deferred = NULL,
+	.active = NULL,
+	.active_num = 0,
+};
+
+/*
+ * Each interrupt increments the generation counter. All requests submitted
+ * before the interrupt are aborted by the I/O thread. Requests submitted
+ * after the interrupt (e.g. the DELETE request sent by the signal handler)
+ * are processed.
+ */
+static atomic_t acvp_curl_multi_interrupt_gen = ATOMIC_INIT(0);
+
+static uint64_t acvp_curl_multi_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void acvp_curl_multi_wakeup(void)
+{
+	uint64_t val = 1;
+
+	if (acvp_curl_multi.evfd < 0)
+		return;
+
+	/* An eventfd write can only fail if the counter overflows */
+	if (write(acvp_curl_multi.evfd, &val, sizeof(val)) != sizeof(val)) {
+		logger(LOGGER_DEBUG, LOGGER_C_CURL,
+		       "Cannot wake up CURL I/O thread\n");
+	}
+}
+
+static void acvp_curl_multi_interrupt(void)
+{
+	atomic_bool_set_true(&acvp_curl_interrupted);
+	atomic_inc(&acvp_curl_multi_interrupt_gen);
+	acvp_curl_multi_wakeup();
+}
+
+/*****************************************************************************
+ * I/O thread
+ *****************************************************************************/
+
+/* Release all resources of a request and invoke its completion callback. */
+static void acvp_curl_multi_finish(struct acvp_curl_multi_req *req, int ret)
+{
+	void (*complete)(void *priv, int ret) = req->complete;
+	void *priv = req->priv;
+
+	acvp_curl_handle_put(req->curl);
+	if (req->slist)
+		curl_slist_free_all(req->slist);
+	free(req);
+
+	complete(priv, ret);
+}
+
+static void acvp_curl_multi_list_del(struct acvp_curl_multi_req **list,
+				     struct acvp_curl_multi_req *req)
+{
+	struct acvp_curl_multi_req **pp;
+
+	for (pp = list; *pp; pp = &(*pp)->next) {
+		if (*pp == req) {
+			*pp = req->next;
+			req->next = NULL;
+			return;
+		}
+	}
+}
+
+static void acvp_curl_multi_add(struct acvp_curl_multi_req *req)
+{
+	CURLMcode mret = curl_multi_add_handle(acvp_curl_multi.multi,
+					       req->curl);
+
+	if (mret != CURLM_OK) {
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Cannot add CURL handle to multi handle: %s\n",
+		       curl_multi_strerror(mret));
+		acvp_curl_multi_finish(req, -EFAULT);
+		return;
+	}
+
+	req->next = acvp_curl_multi.active;
+	acvp_curl_multi.active = req;
+	acvp_curl_multi.active_num++;
+}
+
+/* Abort all requests submitted before the last interrupt / shutdown. */
+static void acvp_curl_multi_abort(bool all)
+{
+	struct acvp_curl_multi_req *req, *next, *keep = NULL;
+	int gen = atomic_read(&acvp_curl_multi_interrupt_gen);
+
+	for (req = acvp_curl_multi.active; req; req = next) {
+		next = req->next;
+		if (!all && req->interrupt_gen == gen) {
+			req->next = keep;
+			keep = req;
+			continue;
+		}
+		curl_multi_remove_handle(acvp_curl_multi.multi, req->curl);
+		acvp_curl_multi.active_num--;
+		acvp_curl_multi_finish(req, -EINTR);
+	}
+	acvp_curl_multi.active = keep;
+
+	keep = NULL;
+	for (req = acvp_curl_multi.deferred; req; req = next) {
+		next = req->next;
+		if (!all && req->interrupt_gen == gen) {
+			req->next = keep;
+			keep = req;
+			continue;
+		}
+		acvp_curl_multi_finish(req, -EINTR);
+	}
+	acvp_curl_multi.deferred = keep;
+}
+
+/* Hand newly submitted requests and due retries to libcurl. */
+static void acvp_curl_multi_schedule(void)
+{
+	struct acvp_curl_multi_req *req, *next, *keep = NULL;
+	uint64_t now = acvp_curl_multi_now();
+
+	pthread_mutex_lock(&acvp_curl_multi.submit_lock);
+	req = acvp_curl_multi.submitted;
+	acvp_curl_multi.submitted = NULL;
+	pthread_mutex_unlock(&acvp_curl_multi.submit_lock);
+
+	for (; req; req = next) {
+		next = req->next;
+		acvp_curl_multi_add(req);
+	}
+
+	for (req = acvp_curl_multi.deferred; req; req = next) {
+		next = req->next;
+		if (req->retry_at > now) {
+			req->next = keep;
+			keep = req;
+			continue;
+		}
+		acvp_curl_multi_add(req);
+	}
+	acvp_curl_multi.deferred = keep;
+}
+
+/* Evaluate all completed transfers. */
+static void acvp_curl_multi_check_done(void)
+{
+	struct acvp_curl_multi_req *req;
+	CURLMsg *msg;
+	int msgs_left;
+
+	while ((msg = curl_multi_info_read(acvp_curl_multi.multi,
+					   &msgs_left))) {
+		CURLcode cret;
+
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+
+		cret = msg->data.result;
+		if (curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+				      (char **)&req) || !req) {
+			logger(LOGGER_ERR, LOGGER_C_CURL,
+			       "CURL handle without request context\n");
+			continue;
+		}
+
+		curl_multi_remove_handle(acvp_curl_multi.multi, req->curl);
+		acvp_curl_multi_list_del(&acvp_curl_multi.active, req);
+		acvp_curl_multi.active_num--;
+
+		if (cret == CURLE_OK) {
+			acvp_curl_multi_finish(req,
+				acvp_curl_http_status(req->curl, req->url));
+			continue;
+		}
+
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Curl HTTP operation failed with code %d (%s)\n",
+		       cret, curl_easy_strerror(cret));
+
+		if (req->interrupt_gen !=
+		    atomic_read(&acvp_curl_multi_interrupt_gen)) {
+			acvp_curl_multi_finish(req, -EINTR);
+			continue;
+		}
+
+		req->retries++;
+		if (req->retries >= ACVP_CURL_MAX_RETRIES) {
+			acvp_curl_multi_finish(req,
+				acvp_curl_http_status(req->curl, req->url));
+			continue;
+		}
+
+		/* Retry the request later without blocking the I/O thread */
+		req->retry_at = acvp_curl_multi_now() +
+				ACVP_CURL_RETRY_WAIT * 1000;
+		req->next = acvp_curl_multi.deferred;
+		acvp_curl_multi.deferred = req;
+	}
+}
+
+/* Calculate the epoll timeout from the libcurl timer and pending retries. */
+static int acvp_curl_multi_timeout(void)
+{
+	struct acvp_curl_multi_req *req;
+	uint64_t now = acvp_curl_multi_now();
+	uint64_t deadline = acvp_curl_multi.timer_at;
+
+	for (req = acvp_curl_multi.deferred; req; req = req->next) {
+		if (!deadline || req->retry_at < deadline)
+			deadline = req->retry_at;
+	}
+
+	if (!deadline)
+		return -1;
+	if (deadline <= now)
+		return 0;
+	if (deadline - now > INT_MAX)
+		return INT_MAX;
+	return (int)(deadline - now);
+}
+
+/* libcurl callback: register socket with epoll */
+static int acvp_curl_multi_socket_cb(CURL *easy, curl_socket_t s, int what,
+				     void *userp, void *socketp)
+{
+	struct epoll_event ev;
+
+	(void)easy;
+	(void)userp;
+	(void)socketp;
+
+	if (what == CURL_POLL_REMOVE) {
+		epoll_ctl(acvp_curl_multi.epfd, EPOLL_CTL_DEL, s, NULL);
+		return 0;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = s;
+	if (what & CURL_POLL_IN)
+		ev.events |= EPOLLIN;
+	if (what & CURL_POLL_OUT)
+		ev.events |= EPOLLOUT;
+
+	if (epoll_ctl(acvp_curl_multi.epfd, EPOLL_CTL_MOD, s, &ev) &&
+	    errno == ENOENT)
+		epoll_ctl(acvp_curl_multi.epfd, EPOLL_CTL_ADD, s, &ev);
+
+	return 0;
+}
+
+/* libcurl callback: set the timer after which libcurl wants to be called */
+static int acvp_curl_multi_timer_cb(CURLM *multi, long timeout_ms,
+				    void *userp)
+{
+	(void)multi;
+	(void)userp;
+
+	if (timeout_ms < 0)
+		acvp_curl_multi.timer_at = 0;
+	else
+		acvp_curl_multi.timer_at = acvp_curl_multi_now() +
+					   (uint64_t)timeout_ms;
+	return 0;
+}
+
+static void *acvp_curl_multi_worker(void *arg)
+{
+	struct epoll_event events[ACVP_CURL_MULTI_EVENTS];
+	sigset_t block, old;
+	int running, interrupt_gen = atomic_read(&acvp_curl_multi_interrupt_gen);
+
+	(void)arg;
+
+	/* Block all signals from being processed by thread */
+	sigfillset(&block);
+	if (pthread_sigmask(SIG_BLOCK, &block, &old))
+		return NULL;
+
+	while (!atomic_bool_read(&acvp_curl_multi.shutdown)) {
+		int i, nfds;
+
+		nfds = epoll_wait(acvp_curl_multi.epfd, events,
+				  ACVP_CURL_MULTI_EVENTS,
+				  acvp_curl_multi_timeout());
+		if (nfds < 0) {
+			if (errno == EINTR)
+				continue;
+			logger(LOGGER_ERR, LOGGER_C_CURL,
+			       "epoll_wait failed: %d\n", -errno);
+			break;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			int mask = 0;
+
+			if (events[i].data.fd == acvp_curl_multi.evfd) {
+				uint64_t val;
+
+				if (read(acvp_curl_multi.evfd, &val,
+					 sizeof(val)) < 0) {
+					logger(LOGGER_DEBUG, LOGGER_C_CURL,
+					       "eventfd read failed\n");
+				}
+				continue;
+			}
+
+			if (events[i].events & EPOLLIN)
+				mask |= CURL_CSELECT_IN;
+			if (events[i].events & EPOLLOUT)
+				mask |= CURL_CSELECT_OUT;
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				mask |= CURL_CSELECT_ERR;
+
+			curl_multi_socket_action(acvp_curl_multi.multi,
+						 events[i].data.fd, mask,
+						 &running);
+		}
+
+		/* Interrupt received: abort all requests submitted before */
+		if (interrupt_gen !=
+		    atomic_read(&acvp_curl_multi_interrupt_gen)) {
+			interrupt_gen =
+				atomic_read(&acvp_curl_multi_interrupt_gen);
+			logger(LOGGER_VERBOSE, LOGGER_C_CURL,
+			       "Interrupt received, aborting HTTP requests\n");
+			acvp_curl_multi_abort(false);
+		}
+
+		/*
+		 * Adding handles sets the libcurl timer to start the new
+		 * transfers immediately.
+		 */
+		acvp_curl_multi_schedule();
+
+		/* Let libcurl process its expired timer */
+		if (acvp_curl_multi.timer_at &&
+		    acvp_curl_multi.timer_at <= acvp_curl_multi_now()) {
+			acvp_curl_multi.timer_at = 0;
+			curl_multi_socket_action(acvp_curl_multi.multi,
+						 CURL_SOCKET_TIMEOUT, 0,
+						 &running);
+		}
+
+		acvp_curl_multi_check_done();
+	}
+
+	/* Shutdown: no request shall be left behind with a waiting caller */
+	acvp_curl_multi_schedule();
+	acvp_curl_multi_abort(true);
+
+	return NULL;
+}
+
+/* Allocate the multi handle and start the I/O thread. */
+static int acvp_curl_multi_start(void)
+{
+	struct epoll_event ev;
+	int ret = 0;
+
+	/* Protected by submit_lock held by caller */
+	if (acvp_curl_multi.started)
+		return 0;
+
+	acvp_curl_multi.multi = curl_multi_init();
+	CKNULL_LOG(acvp_curl_multi.multi, -ENOMEM,
+		   "Cannot allocate CURL multi handle\n");
+
+	CKINT(curl_multi_setopt(acvp_curl_multi.multi,
+				CURLMOPT_SOCKETFUNCTION,
+				acvp_curl_multi_socket_cb));
+	CKINT(curl_multi_setopt(acvp_curl_multi.multi, CURLMOPT_TIMERFUNCTION,
+				acvp_curl_multi_timer_cb));
+
+	acvp_curl_multi.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (acvp_curl_multi.epfd < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_CURL, "Cannot create epoll fd\n");
+		goto out;
+	}
+
+	acvp_curl_multi.evfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (acvp_curl_multi.evfd < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_CURL, "Cannot create eventfd\n");
+		goto out;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = acvp_curl_multi.evfd;
+	if (epoll_ctl(acvp_curl_multi.epfd, EPOLL_CTL_ADD, acvp_curl_multi.evfd,
+		      &ev)) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = -pthread_create(&acvp_curl_multi.thread, NULL,
+			      acvp_curl_multi_worker, NULL);
+	if (ret)
+		goto out;
+
+	acvp_curl_multi.started = true;
+	logger(LOGGER_VERBOSE, LOGGER_C_CURL, "CURL I/O thread started\n");
+
+out:
+	if (ret) {
+		if (acvp_curl_multi.evfd >= 0)
+			close(acvp_curl_multi.evfd);
+		acvp_curl_multi.evfd = -1;
+		if (acvp_curl_multi.epfd >= 0)
+			close(acvp_curl_multi.epfd);
+		acvp_curl_multi.epfd = -1;
+		if (acvp_curl_multi.multi)
+			curl_multi_cleanup(acvp_curl_multi.multi);
+		acvp_curl_multi.multi = NULL;
+	}
+	return ret;
+}
+
+/*****************************************************************************
+ * Asynchronous API
+ *****************************************************************************/
+
+static int acvp_curl_multi_async(const struct acvp_na_ex *netinfo,
+				 enum acvp_http_type http_type,
+				 const struct acvp_buf *submit_buf,
+				 struct acvp_buf *response_buf,
+				 void (*complete)(void *priv, int ret),
+				 void *priv)
+{
+	struct acvp_curl_multi_req *req = NULL;
+	int ret;
+
+	CKNULL_LOG(complete, -EINVAL, "Completion callback missing\n");
+
+	if (atomic_bool_read(&acvp_curl_multi.shutdown))
+		return -ESHUTDOWN;
+
+	req = calloc(1, sizeof(*req));
+	CKNULL(req, -ENOMEM);
+
+	req->curl = acvp_curl_handle_get();
+	CKNULL(req->curl, -ENOMEM);
+
+	CKINT(acvp_curl_http_setup(req->curl, netinfo, submit_buf,
+				   response_buf, http_type, &req->slist));
+	CKINT(curl_easy_setopt(req->curl, CURLOPT_PRIVATE, req));
+
+	req->url = netinfo->url;
+	req->complete = complete;
+	req->priv = priv;
+	req->interrupt_gen = atomic_read(&acvp_curl_multi_interrupt_gen);
+
+	/*
+	 * Clear any interrupt triggered by signal handler to allow
+	 * signal handler to perform network requests.
+	 */
+	atomic_bool_set_false(&acvp_curl_interrupted);
+
+	pthread_mutex_lock(&acvp_curl_multi.submit_lock);
+	ret = acvp_curl_multi_start();
+	if (!ret) {
+		req->next = acvp_curl_multi.submitted;
+		acvp_curl_multi.submitted = req;
+	}
+	pthread_mutex_unlock(&acvp_curl_multi.submit_lock);
+	if (ret)
+		goto out;
+
+	acvp_curl_multi_wakeup();
+
+	return 0;
+
+out:
+	if (req) {
+		acvp_curl_handle_put(req->curl);
+		if (req->slist)
+			curl_slist_free_all(req->slist);
+		free(req);
+	}
+	return ret;
+}
+
+/*****************************************************************************
+ * Synchronous API
+ *****************************************************************************/
+
+struct acvp_curl_multi_sync {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool done;
+	int ret;
+};
+
+static void acvp_curl_multi_sync_complete(void *priv, int ret)
+{
+	struct acvp_curl_multi_sync *sync = priv;
+
+	pthread_mutex_lock(&sync->lock);
+	sync->ret = ret;
+	sync->done = true;
+	pthread_cond_signal(&sync->cond);
+	pthread_mutex_unlock(&sync->lock);
+}
+
+static int acvp_curl_multi_sync(const struct acvp_na_ex *netinfo,
+				const struct acvp_buf *submit_buf,
+				struct acvp_buf *response_buf,
+				enum acvp_http_type http_type)
+{
+	struct acvp_curl_multi_sync sync = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.done = false,
+		.ret = 0,
+	};
+	int ret;
+
+	ret = acvp_curl_multi_async(netinfo, http_type, submit_buf,
+				    response_buf,
+				    acvp_curl_multi_sync_complete, &sync);
+	if (ret)
+		return ret;
+
+	pthread_mutex_lock(&sync.lock);
+	while (!sync.done)
+		pthread_cond_wait(&sync.cond, &sync.lock);
+	pthread_mutex_unlock(&sync.lock);
+
+	pthread_cond_destroy(&sync.cond);
+	pthread_mutex_destroy(&sync.lock);
+
+	return sync.ret;
+}
+
+static int acvp_curl_multi_http_post(const struct acvp_na_ex *netinfo,
+				     const struct acvp_buf *submit_buf,
+				     struct acvp_buf *response_buf)
+{
+	return acvp_curl_multi_sync(netinfo, submit_buf, response_buf,
+				    ACVP_HTTP_POST);
+}
+
+static int acvp_curl_multi_http_get(const struct acvp_na_ex *netinfo,
+				    struct acvp_buf *response_buf)
+{
+	return acvp_curl_multi_sync(netinfo, NULL, response_buf,
+				    ACVP_HTTP_GET);
+}
+
+static int acvp_curl_multi_http_put(const struct acvp_na_ex *netinfo,
+				    const struct acvp_buf *submit_buf,
+				    struct acvp_buf *response_buf)
+{
+	return acvp_curl_multi_sync(netinfo, submit_buf, response_buf,
+				    ACVP_HTTP_PUT);
+}
+
+static int acvp_curl_multi_http_delete(const struct acvp_na_ex *netinfo)
+{
+	return acvp_curl_multi_sync(netinfo, NULL, NULL, ACVP_HTTP_DELETE);
+}
+
+static struct acvp_netaccess_be acvp_netaccess_curl_multi = {
+	&acvp_curl_multi_http_post,
+	&acvp_curl_multi_http_get,
+	&acvp_curl_multi_http_put,
+	&acvp_curl_multi_http_delete,
+	&acvp_curl_multi_interrupt,
+	&acvp_curl_multi_async
+};
+
+ACVP_DEFINE_CONSTRUCTOR(acvp_curl_multi_init)
+static void acvp_curl_multi_init(void)
+{
+#ifdef ACVP_CURL_MULTI
+	acvp_register_na(&acvp_netaccess_curl_multi);
+#else
+	/* The curl-easy backend is used */
+	(void)acvp_netaccess_curl_multi;
+#endif
+}
+
+ACVP_DEFINE_DESTRUCTOR(acvp_curl_multi_fini)
+static void acvp_curl_multi_fini(void)
+{
+	bool started;
+
+	pthread_mutex_lock(&acvp_curl_multi.submit_lock);
+	atomic_bool_set_true(&acvp_curl_multi.shutdown);
+	started = acvp_curl_multi.started;
+	pthread_mutex_unlock(&acvp_curl_multi.submit_lock);
+
+	if (!started)
+		return;
+
+	acvp_curl_multi_wakeup();
+	pthread_join(acvp_curl_multi.thread, NULL);
+
+	curl_multi_cleanup(acvp_curl_multi.multi);
+	acvp_curl_multi.multi = NULL;
+	close(acvp_curl_multi.evfd);
+	acvp_curl_multi.evfd = -1;
+	close(acvp_curl_multi.epfd);
+	acvp_curl_multi.epfd = -1;
+}